@@ -2,18 +2,46 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
 
 #define MAX_STR_LEN 1024
 #ifndef __testing
 #define MAT_SIZE 10
 #endif
+#define BRAND_WORDS ((MAT_SIZE + 63) / 64)
+#define PPR_WALKS 8
+#define PPR_WALK_LEN 8
+#define PPR_RESET_PERCENT 15
+#define INDEX_ORDER 32
+#define INDEX_MIN_KEYS (INDEX_ORDER / 2 - 1)
+#define DUMP_BUF_SIZE 8192
+
+// One step of a stored walk: owner->walks[walk][step] is the user that keeps
+// this entry in its visits.
+typedef struct walk_visit_struct {
+    struct user_struct* owner;
+    int walk;
+    int step;
+} WalkVisit;
 
 typedef struct user_struct {
     char name[MAX_STR_LEN];
     struct friend_node_struct* friends;
     struct brand_node_struct* brands;
+    uint64_t brand_set[BRAND_WORDS];
     bool visited;
     int level;
+    struct user_struct* walks[PPR_WALKS][PPR_WALK_LEN];
+    int walk_slots[PPR_WALKS][PPR_WALK_LEN];
+    int walk_stamp[PPR_WALKS];
+    WalkVisit* visits;
+    int num_visits;
+    int visits_cap;
+    int walk_hits;
+    int mutual_hits;
+    int friend_stamp;
+    int seen_stamp;
 } User;
 
 typedef struct friend_node_struct {
@@ -26,10 +54,31 @@ typedef struct brand_node_struct {
     struct brand_node_struct* next;
 } BrandNode;
 
+// B+ tree over user names. Leaf keys point at the users' own names, inner
+// keys are separator copies owned by the node.
+typedef struct index_node_struct {
+    bool leaf;
+    int count;
+    char* keys[INDEX_ORDER];
+    User* users[INDEX_ORDER];
+    struct index_node_struct* children[INDEX_ORDER + 1];
+    struct index_node_struct* next;
+} IndexNode;
+
 FriendNode* allUsers; 
+IndexNode* userIndex;
+int walk_update_stamp;
+int suggest_stamp;
+User** graph_candidates;
+int graph_candidates_cap;
 
 int brand_adjacency_matrix[MAT_SIZE][MAT_SIZE];
 char brand_names[MAT_SIZE][MAX_STR_LEN];
+// Bit-packed rows of brand_adjacency_matrix. Together with each user's
+// brand_set they make brand scoring an AND and a popcount per word.
+uint64_t brand_similarity[MAT_SIZE][BRAND_WORDS];
+// Position of each brand name in sorted order, for breaking ties.
+int brand_name_rank[MAT_SIZE];
 
 /**
  * Checks if a user is inside a FriendNode LL.
@@ -62,10 +111,7 @@ bool in_brand_list(BrandNode *head, char *name) {
 FriendNode *insert_into_friend_list(FriendNode *head, User *node) {
   if (node == NULL) return head;
 
-  if (in_friend_list(head, node)) {
-    printf("User already in list\n");
-    return head;
-  }
+  if (in_friend_list(head, node)) return head;
   FriendNode *fn = calloc(1, sizeof(FriendNode));
   fn->user = node;
   fn->next = NULL;
@@ -94,10 +140,7 @@ FriendNode *insert_into_friend_list(FriendNode *head, User *node) {
 BrandNode *insert_into_brand_list(BrandNode *head, char *node) {
   if (node == NULL) return head;
 
-  if (in_brand_list(head, node)) {
-    printf("Brand already in list\n");
-    return head;
-  }
+  if (in_brand_list(head, node)) return head;
   BrandNode *fn = calloc(1, sizeof(BrandNode));
   strcpy(fn->brand_name, node);
   fn->next = NULL;
@@ -126,10 +169,7 @@ BrandNode *insert_into_brand_list(BrandNode *head, char *node) {
 FriendNode *delete_from_friend_list(FriendNode *head, User *node) {
   if (node == NULL) return head;
 
-  if (!in_friend_list(head, node)) {
-    printf("User not in list\n");
-    return head;
-  }
+  if (!in_friend_list(head, node)) return head;
 
   if (strcmp(head->user->name, node->name) == 0) {
     FriendNode *temp = head->next;
@@ -154,10 +194,7 @@ FriendNode *delete_from_friend_list(FriendNode *head, User *node) {
 BrandNode *delete_from_brand_list(BrandNode *head, char *node) {
   if (node == NULL) return head;
 
-  if (!in_brand_list(head, node)) {
-    printf("Brand not in list\n");
-    return head;
-  }
+  if (!in_brand_list(head, node)) return head;
 
   if (strcmp(head->brand_name, node) == 0) {
     BrandNode *temp = head->next;
@@ -175,21 +212,6 @@ BrandNode *delete_from_brand_list(BrandNode *head, char *node) {
   return head;
 }
 
-/**
- * Prints out the user data.
- **/
-void print_user_data(User *user) {
-  printf("User name: %s\n", user->name);
-  printf("Friends:\n");
-  for (FriendNode *f = user->friends; f != NULL; f = f->next) {
-    printf("   %s\n", f->user->name);
-  }
-  printf("Brands:\n");
-  for (BrandNode *b = user->brands; b != NULL; b = b->next) {
-    printf("   %s\n", b->brand_name);
-  }
-}
-
 /**
  * Get the index into brand_names for the given brand name. If it doesn't
  * exist in the array, return -1
@@ -200,28 +222,212 @@ int get_brand_index(char *name) {
       return i;
     }
   }
-  printf("brand '%s' not found\n", name);
   return -1; // Not found
 }
+
+// Queries
+// The list_* functions write up to cap results into out (which may be NULL
+// when cap is 0) without printing or allocating. They return the total
+// number of results, which is more than cap if out was too small, or -1 on
+// failure.
+/**
+ * Lists the friends of a user in name order.
+ **/
+int list_friends(User *user, User **out, int cap) {
+  if (!user) return -1;
+  int n = 0;
+  for (FriendNode *f = user->friends; f != NULL; f = f->next, n++) {
+    if (n < cap) out[n] = f->user;
+  }
+  return n;
+}
+
 /**
- * Print out brand name, index and similar brands.
+ * Lists the brands a user follows in name order.
  **/
-void print_brand_data(char *brand_name) {
+int list_brands(User *user, char **out, int cap) {
+  if (!user) return -1;
+  int n = 0;
+  for (BrandNode *b = user->brands; b != NULL; b = b->next, n++) {
+    if (n < cap) out[n] = b->brand_name;
+  }
+  return n;
+}
+
+/**
+ * Lists the brands marked similar to the given brand, in index order.
+ **/
+int list_similar_brands(char *brand_name, char **out, int cap) {
+  int idx = get_brand_index(brand_name);
+  if (idx < 0) return -1;
+  int n = 0;
+  for (int i = 0; i < MAT_SIZE; i++) {
+    if (brand_adjacency_matrix[idx][i] == 1 && strcmp(brand_names[i], "") != 0) {
+      if (n < cap) out[n] = brand_names[i];
+      n++;
+    }
+  }
+  return n;
+}
+
+/**
+ * Lists the mutual friends of two users in name order. Both friend lists
+ * are sorted, so this is a single merge pass.
+ **/
+int list_mutual_friends(User *a, User *b, User **out, int cap) {
+  if (!a || !b) return -1;
+  int n = 0;
+  FriendNode *x = a->friends, *y = b->friends;
+  while (x && y) {
+    int cmp = strcmp(x->user->name, y->user->name);
+    if (cmp == 0) {
+      if (n < cap) out[n] = x->user;
+      n++;
+    }
+    if (cmp <= 0) x = x->next;
+    if (cmp >= 0) y = y->next;
+  }
+  return n;
+}
+
+// Dumps
+/**
+ * Output buffer for the print/dump functions, so that a dump costs a few
+ * large writes instead of one stdio call per line.
+ **/
+typedef struct {
+  FILE *out;
+  size_t len;
+  char buf[DUMP_BUF_SIZE];
+} DumpBuffer;
+
+void dump_flush(DumpBuffer *d) {
+  fwrite(d->buf, 1, d->len, d->out);
+  d->len = 0;
+}
+
+/**
+ * Appends the given strings (up to the NULL terminating the list) to the
+ * buffer, flushing as it fills up.
+ **/
+void dump_line(DumpBuffer *d, char *first, ...) {
+  va_list args;
+  va_start(args, first);
+  for (char *s = first; s != NULL; s = va_arg(args, char *)) {
+    for (; *s; s++) {
+      if (d->len == DUMP_BUF_SIZE) dump_flush(d);
+      d->buf[d->len++] = *s;
+    }
+  }
+  va_end(args);
+  if (d->len == DUMP_BUF_SIZE) dump_flush(d);
+  d->buf[d->len++] = '\n';
+}
+
+/**
+ * Writes out the user data.
+ **/
+void dump_user_data(DumpBuffer *d, User *user) {
+  dump_line(d, "User name: ", user->name, NULL);
+  dump_line(d, "Friends:", NULL);
+  for (FriendNode *f = user->friends; f != NULL; f = f->next) {
+    dump_line(d, "   ", f->user->name, NULL);
+  }
+  dump_line(d, "Brands:", NULL);
+  for (BrandNode *b = user->brands; b != NULL; b = b->next) {
+    dump_line(d, "   ", b->brand_name, NULL);
+  }
+}
+
+/**
+ * Writes out brand name, index and similar brands.
+ **/
+void dump_brand_data(DumpBuffer *d, char *brand_name) {
   int idx = get_brand_index(brand_name);
   if (idx < 0) {
-    printf("Brand '%s' not in the list.\n", brand_name);
+    dump_line(d, "Brand '", brand_name, "' not in the list.", NULL);
     return;
   }
-  printf("Brand name: %s\n", brand_name);
-  printf("Brand idx: %d\n", idx);
-  printf("Similar brands:\n");
+  char idx_str[16];
+  snprintf(idx_str, sizeof(idx_str), "%d", idx);
+  dump_line(d, "Brand name: ", brand_name, NULL);
+  dump_line(d, "Brand idx: ", idx_str, NULL);
+  dump_line(d, "Similar brands:", NULL);
   for (int i = 0; i < MAT_SIZE; i++) {
     if (brand_adjacency_matrix[idx][i] == 1 && strcmp(brand_names[i], "") != 0) {
-      printf("   %s\n", brand_names[i]);
+      dump_line(d, "   ", brand_names[i], NULL);
     }
   }
 }
 
+/**
+ * Writes out the data of every user, in name order, to the given file.
+ **/
+void dump_all_users(FILE *out) {
+  DumpBuffer d;
+  d.out = out;
+  d.len = 0;
+  for (FriendNode *f = allUsers; f != NULL; f = f->next) {
+    dump_user_data(&d, f->user);
+  }
+  dump_flush(&d);
+}
+
+/**
+ * Prints out the user data.
+ **/
+void print_user_data(User *user) {
+  DumpBuffer d;
+  d.out = stdout;
+  d.len = 0;
+  dump_user_data(&d, user);
+  dump_flush(&d);
+}
+
+/**
+ * Print out brand name, index and similar brands.
+ **/
+void print_brand_data(char *brand_name) {
+  DumpBuffer d;
+  d.out = stdout;
+  d.len = 0;
+  dump_brand_data(&d, brand_name);
+  dump_flush(&d);
+}
+
+/**
+ * Sets or clears bit i of a brand word array.
+ **/
+void set_brand_bit(uint64_t *set, int i, bool value) {
+  uint64_t bit = (uint64_t)1 << (i % 64);
+  set[i / 64] = value ? set[i / 64] | bit : set[i / 64] & ~bit;
+}
+
+/**
+ * Returns the number of brands set in both word arrays.
+ **/
+int count_shared_brands(uint64_t *a, uint64_t *b) {
+  int n = 0;
+  for (int w = 0; w < BRAND_WORDS; w++) {
+    n += __builtin_popcountll(a[w] & b[w]);
+  }
+  return n;
+}
+
+int compare_brand_names(const void *a, const void *b) {
+  return strcmp(brand_names[*(const int *)a], brand_names[*(const int *)b]);
+}
+
+/**
+ * Rebuilds brand_name_rank from brand_names.
+ **/
+void rank_brand_names(void) {
+  int order[MAT_SIZE];
+  for (int i = 0; i < MAT_SIZE; i++) order[i] = i;
+  qsort(order, MAT_SIZE, sizeof(int), compare_brand_names);
+  for (int i = 0; i < MAT_SIZE; i++) brand_name_rank[order[i]] = i;
+}
+
 /**
  * Read from a given file and populate a the brand list and brand matrix.
  **/
@@ -241,6 +447,7 @@ void populate_brand_matrix(char* file_name) {
         strncpy(brand_names[i], line, index);
         line = strchr(line, ',') + sizeof(char);
     }
+    rank_brand_names();
     // Load up the brand_adjacency_matrix
     for (int x = 0; x < MAT_SIZE; x++) {
         fscanf(f, "%s", buff);
@@ -249,24 +456,454 @@ void populate_brand_matrix(char* file_name) {
             if (value == 48) { value = 0; }
             else {value = 1;}
             brand_adjacency_matrix[x][y] = value;
+            set_brand_bit(brand_similarity[x], y, value);
         }
     }
 }
 
+// User index
+/**
+ * Returns the first slot in node whose key is >= name (or > name if
+ * strict), using binary search.
+ **/
+int index_slot(IndexNode *node, char *name, bool strict) {
+  int lo = 0, hi = node->count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    int cmp = strcmp(node->keys[mid], name);
+    if (cmp < 0 || (strict && cmp == 0)) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * Returns the leaf of userIndex that name belongs in, or NULL if the index
+ * is empty.
+ **/
+IndexNode *index_find_leaf(char *name) {
+  IndexNode *node = userIndex;
+  while (node && !node->leaf) {
+    node = node->children[index_slot(node, name, true)];
+  }
+  return node;
+}
+
+/**
+ * Inserts user into the subtree at node. If node had to split, the new
+ * right sibling is returned and *sep is set to its separator key,
+ * otherwise returns NULL.
+ **/
+IndexNode *index_insert_into(IndexNode *node, User *user, char **sep) {
+  if (node->leaf) {
+    int pos = index_slot(node, user->name, false);
+    if (pos < node->count && node->users[pos] == user) return NULL;
+    memmove(&node->keys[pos + 1], &node->keys[pos], (node->count - pos) * sizeof(char *));
+    memmove(&node->users[pos + 1], &node->users[pos], (node->count - pos) * sizeof(User *));
+    node->keys[pos] = user->name;
+    node->users[pos] = user;
+    if (++node->count < INDEX_ORDER) return NULL;
+
+    IndexNode *right = calloc(1, sizeof(IndexNode));
+    right->leaf = true;
+    right->count = INDEX_ORDER / 2;
+    node->count = INDEX_ORDER - right->count;
+    memcpy(right->keys, &node->keys[node->count], right->count * sizeof(char *));
+    memcpy(right->users, &node->users[node->count], right->count * sizeof(User *));
+    right->next = node->next;
+    node->next = right;
+    *sep = strdup(right->keys[0]);
+    return right;
+  }
+
+  int pos = index_slot(node, user->name, true);
+  char *child_sep = NULL;
+  IndexNode *child = index_insert_into(node->children[pos], user, &child_sep);
+  if (!child) return NULL;
+  memmove(&node->keys[pos + 1], &node->keys[pos], (node->count - pos) * sizeof(char *));
+  memmove(&node->children[pos + 2], &node->children[pos + 1], (node->count - pos) * sizeof(IndexNode *));
+  node->keys[pos] = child_sep;
+  node->children[pos + 1] = child;
+  if (++node->count < INDEX_ORDER) return NULL;
+
+  // The middle key moves up, the keys after it go to the new sibling
+  int mid = INDEX_ORDER / 2;
+  IndexNode *right = calloc(1, sizeof(IndexNode));
+  right->leaf = false;
+  right->count = INDEX_ORDER - mid - 1;
+  memcpy(right->keys, &node->keys[mid + 1], right->count * sizeof(char *));
+  memcpy(right->children, &node->children[mid + 1], (right->count + 1) * sizeof(IndexNode *));
+  node->count = mid;
+  *sep = node->keys[mid];
+  return right;
+}
+
+/**
+ * Adds a user to userIndex.
+ **/
+void index_insert(User *user) {
+  if (!userIndex) {
+    userIndex = calloc(1, sizeof(IndexNode));
+    userIndex->leaf = true;
+  }
+  char *sep = NULL;
+  IndexNode *right = index_insert_into(userIndex, user, &sep);
+  if (right) {
+    IndexNode *root = calloc(1, sizeof(IndexNode));
+    root->leaf = false;
+    root->count = 1;
+    root->keys[0] = sep;
+    root->children[0] = userIndex;
+    root->children[1] = right;
+    userIndex = root;
+  }
+}
+
+/**
+ * Fixes parent->children[pos] after it dropped below INDEX_MIN_KEYS by
+ * borrowing a key from a sibling, or merging with it if the sibling has none
+ * to spare. The parent may be left underfull in turn.
+ **/
+void index_rebalance(IndexNode *parent, int pos) {
+  IndexNode *child = parent->children[pos];
+  IndexNode *left = pos > 0 ? parent->children[pos - 1] : NULL;
+  IndexNode *right = pos < parent->count ? parent->children[pos + 1] : NULL;
+
+  if (left && left->count > INDEX_MIN_KEYS) {
+    memmove(&child->keys[1], &child->keys[0], child->count * sizeof(char *));
+    if (child->leaf) {
+      memmove(&child->users[1], &child->users[0], child->count * sizeof(User *));
+      child->keys[0] = left->keys[left->count - 1];
+      child->users[0] = left->users[left->count - 1];
+      free(parent->keys[pos - 1]);
+      parent->keys[pos - 1] = strdup(child->keys[0]);
+    } else {
+      memmove(&child->children[1], &child->children[0], (child->count + 1) * sizeof(IndexNode *));
+      child->keys[0] = parent->keys[pos - 1];
+      child->children[0] = left->children[left->count];
+      parent->keys[pos - 1] = left->keys[left->count - 1];
+    }
+    left->count--;
+    child->count++;
+    return;
+  }
+
+  if (right && right->count > INDEX_MIN_KEYS) {
+    if (child->leaf) {
+      child->keys[child->count] = right->keys[0];
+      child->users[child->count] = right->users[0];
+      memmove(&right->users[0], &right->users[1], (right->count - 1) * sizeof(User *));
+      memmove(&right->keys[0], &right->keys[1], (right->count - 1) * sizeof(char *));
+      free(parent->keys[pos]);
+      parent->keys[pos] = strdup(right->keys[0]);
+    } else {
+      child->keys[child->count] = parent->keys[pos];
+      child->children[child->count + 1] = right->children[0];
+      parent->keys[pos] = right->keys[0];
+      memmove(&right->keys[0], &right->keys[1], (right->count - 1) * sizeof(char *));
+      memmove(&right->children[0], &right->children[1], right->count * sizeof(IndexNode *));
+    }
+    right->count--;
+    child->count++;
+    return;
+  }
+
+  // Merge the pair into its left node and drop the separator between them
+  int sep = left ? pos - 1 : pos;
+  IndexNode *into = parent->children[sep];
+  IndexNode *from = parent->children[sep + 1];
+  if (into->leaf) {
+    memcpy(&into->keys[into->count], from->keys, from->count * sizeof(char *));
+    memcpy(&into->users[into->count], from->users, from->count * sizeof(User *));
+    into->count += from->count;
+    into->next = from->next;
+    free(parent->keys[sep]);
+  } else {
+    into->keys[into->count] = parent->keys[sep];
+    memcpy(&into->keys[into->count + 1], from->keys, from->count * sizeof(char *));
+    memcpy(&into->children[into->count + 1], from->children, (from->count + 1) * sizeof(IndexNode *));
+    into->count += from->count + 1;
+  }
+  free(from);
+  memmove(&parent->keys[sep], &parent->keys[sep + 1], (parent->count - sep - 1) * sizeof(char *));
+  memmove(&parent->children[sep + 1], &parent->children[sep + 2], (parent->count - sep - 1) * sizeof(IndexNode *));
+  parent->count--;
+}
+
+/**
+ * Removes user from the subtree at node, rebalancing any child that
+ * underflows on the way back up.
+ **/
+void index_remove_from(IndexNode *node, User *user) {
+  if (node->leaf) {
+    int pos = index_slot(node, user->name, false);
+    if (pos == node->count || node->users[pos] != user) return;
+    memmove(&node->keys[pos], &node->keys[pos + 1], (node->count - pos - 1) * sizeof(char *));
+    memmove(&node->users[pos], &node->users[pos + 1], (node->count - pos - 1) * sizeof(User *));
+    node->count--;
+    return;
+  }
+  int pos = index_slot(node, user->name, true);
+  index_remove_from(node->children[pos], user);
+  if (node->children[pos]->count < INDEX_MIN_KEYS) index_rebalance(node, pos);
+}
+
+/**
+ * Removes a user from userIndex. Every node but the root stays at least
+ * half full, so a scan reads O(k / INDEX_ORDER) leaves after its seek.
+ **/
+void index_remove(User *user) {
+  if (!userIndex) return;
+  index_remove_from(userIndex, user);
+  if (!userIndex->leaf && userIndex->count == 0) {
+    IndexNode *root = userIndex;
+    userIndex = root->children[0];
+    free(root);
+  }
+}
+
+/**
+ * Returns the user with the given name, or NULL if there isn't one.
+ **/
+User* find_user(char *name) {
+  if (!name) return NULL;
+  IndexNode *leaf = index_find_leaf(name);
+  if (!leaf) return NULL;
+  int pos = index_slot(leaf, name, false);
+  if (pos < leaf->count && strcmp(leaf->keys[pos], name) == 0) {
+    return leaf->users[pos];
+  }
+  return NULL;
+}
+
+/**
+ * Writes up to limit users into out, in name order, starting at the first
+ * name >= from (or > from if strict; from the smallest name if from is NULL)
+ * and stopping before the first name that fails to match prefix (if given)
+ * or is >= before (if given). Returns how many users were written.
+ **/
+int index_scan(char *from, bool strict, char *prefix, char *before, User **out, int limit) {
+  if (!userIndex || limit < 1) return 0;
+  IndexNode *leaf = userIndex;
+  int pos = 0;
+  if (from) {
+    leaf = index_find_leaf(from);
+    pos = index_slot(leaf, from, strict);
+  } else {
+    while (!leaf->leaf) leaf = leaf->children[0];
+  }
+  size_t prefix_len = prefix ? strlen(prefix) : 0;
+  int n = 0;
+  for (; leaf && n < limit; leaf = leaf->next, pos = 0) {
+    for (; pos < leaf->count && n < limit; pos++) {
+      if (prefix && strncmp(leaf->keys[pos], prefix, prefix_len) != 0) return n;
+      if (before && strcmp(leaf->keys[pos], before) >= 0) return n;
+      out[n++] = leaf->users[pos];
+    }
+  }
+  return n;
+}
+
+/**
+ * Writes up to limit users whose names start with prefix into out, in name
+ * order. Returns how many users were written.
+ **/
+int find_users_by_prefix(char *prefix, User **out, int limit) {
+  if (!prefix || !out) return 0;
+  return index_scan(prefix, false, prefix, NULL, out, limit);
+}
+
+/**
+ * Writes up to limit users whose names are strictly between after and
+ * before into out, in name order. A NULL bound is unbounded. To page
+ * through all users, pass the last name of the previous page as after.
+ * Returns how many users were written.
+ **/
+int get_users_in_range(char *after, char *before, User **out, int limit) {
+  if (!out) return 0;
+  return index_scan(after, true, NULL, before, out, limit);
+}
+
+// Random walks
+/**
+ * Returns the number of users in a FriendNode LL.
+ **/
+int friend_list_length(FriendNode *head) {
+  int n = 0;
+  for (FriendNode *cur = head; cur != NULL; cur = cur->next) n++;
+  return n;
+}
+
+/**
+ * Returns a uniformly random user from a FriendNode LL, or NULL if the LL
+ * is empty.
+ **/
+User *random_friend(FriendNode *head) {
+  int n = friend_list_length(head);
+  if (n == 0) return NULL;
+  FriendNode *cur = head;
+  for (int k = rand() % n; k > 0; k--) cur = cur->next;
+  return cur->user;
+}
+
+/**
+ * Records that owner's walk w visits user at the given step.
+ **/
+void add_visit(User *user, User *owner, int w, int step) {
+  if (user->num_visits == user->visits_cap) {
+    user->visits_cap = user->visits_cap ? user->visits_cap * 2 : 8;
+    user->visits = realloc(user->visits, user->visits_cap * sizeof(WalkVisit));
+  }
+  WalkVisit *v = &user->visits[user->num_visits];
+  v->owner = owner;
+  v->walk = w;
+  v->step = step;
+  owner->walk_slots[w][step] = user->num_visits++;
+}
+
+/**
+ * Forgets that owner's walk w visits user at the given step by moving the
+ * user's last visit into its slot.
+ **/
+void remove_visit(User *user, User *owner, int w, int step) {
+  int slot = owner->walk_slots[w][step];
+  WalkVisit *last = &user->visits[--user->num_visits];
+  user->visits[slot] = *last;
+  last->owner->walk_slots[last->walk][last->step] = slot;
+}
+
+/**
+ * Sets step i of owner's walk w to user (or NULL), keeping the visits of
+ * the old and new user up to date.
+ **/
+void set_walk_step(User *owner, int w, int i, User *user) {
+  User *old = owner->walks[w][i];
+  if (old == user) return;
+  if (old) remove_visit(old, owner, w, i);
+  owner->walks[w][i] = user;
+  if (user) add_visit(user, owner, w, i);
+}
+
+/**
+ * Regenerates walk w of the given user after step i. Every later step moves
+ * to a random friend of the previous one, and the walk ends early (NULL) on
+ * a reset or when it reaches a user with no friends.
+ **/
+void extend_walk(User *user, int w, int i) {
+  for (int j = i + 1; j < PPR_WALK_LEN; j++) {
+    User *prev = user->walks[w][j - 1];
+    User *next = NULL;
+    if (prev && rand() % 100 >= PPR_RESET_PERCENT) {
+      next = random_friend(prev->friends);
+    }
+    set_walk_step(user, w, j, next);
+  }
+}
+
+/**
+ * Starts a fresh set of walks from the given user.
+ **/
+void init_walks(User *user) {
+  for (int w = 0; w < PPR_WALKS; w++) {
+    set_walk_step(user, w, 0, user);
+    extend_walk(user, w, 0);
+  }
+}
+
+/**
+ * Returns a new array with the visits of a and of b (which may be NULL),
+ * sorted by step, and sets *n to its length. Walks change while the copy is
+ * processed, so callers must check that each visit is still current.
+ **/
+WalkVisit *snapshot_visits(User *a, User *b, int *n) {
+  int counts[PPR_WALK_LEN + 1] = {0};
+  *n = a->num_visits + (b ? b->num_visits : 0);
+  WalkVisit *sorted = malloc((*n > 0 ? *n : 1) * sizeof(WalkVisit));
+  for (int k = 0; k < a->num_visits; k++) counts[a->visits[k].step + 1]++;
+  for (int k = 0; b && k < b->num_visits; k++) counts[b->visits[k].step + 1]++;
+  for (int i = 1; i <= PPR_WALK_LEN; i++) counts[i] += counts[i - 1];
+  for (int k = 0; k < a->num_visits; k++) sorted[counts[a->visits[k].step]++] = a->visits[k];
+  for (int k = 0; b && k < b->num_visits; k++) sorted[counts[b->visits[k].step]++] = b->visits[k];
+  return sorted;
+}
+
+/**
+ * Repairs the stored walks after the friendship between a and b was added
+ * (added is true) or removed; must be called after both friend lists were
+ * updated. Only the steps leaving a or b can change, and the visits of a
+ * and b say exactly which walks those are: on an add, a step out of a is
+ * redirected to b with probability 1/deg(a) (and a walk that used to
+ * dead-end at a is resumed); on a remove, a step from a to b is resampled.
+ * Everything after a changed step is regenerated, and a walk is repaired at
+ * most once per call, at its earliest affected step.
+ **/
+void update_walks(User *a, User *b, bool added) {
+  int deg_a = friend_list_length(a->friends);
+  int deg_b = friend_list_length(b->friends);
+  int n;
+  WalkVisit *visits = snapshot_visits(a, b, &n);
+  int stamp = ++walk_update_stamp;
+  for (int k = 0; k < n; k++) {
+    User *owner = visits[k].owner;
+    int w = visits[k].walk, i = visits[k].step;
+    User *cur = owner->walks[w][i];
+    if (owner->walk_stamp[w] == stamp || i == PPR_WALK_LEN - 1) continue;
+    if (cur != a && cur != b) continue;
+    User *other = cur == a ? b : a;
+    int deg = cur == a ? deg_a : deg_b;
+    User *next = owner->walks[w][i + 1];
+    if (added && !next && deg == 1) {
+      extend_walk(owner, w, i);
+      owner->walk_stamp[w] = stamp;
+    } else if (added && next && rand() % deg == 0) {
+      set_walk_step(owner, w, i + 1, other);
+      extend_walk(owner, w, i + 1);
+      owner->walk_stamp[w] = stamp;
+    } else if (!added && next == other) {
+      set_walk_step(owner, w, i + 1, random_friend(cur->friends));
+      extend_walk(owner, w, i + 1);
+      owner->walk_stamp[w] = stamp;
+    }
+  }
+  free(visits);
+}
+
+/**
+ * Drops the given user's walks and reroutes every stored walk that steps
+ * into the user, who must already be unlinked from allUsers and from all
+ * friend lists.
+ **/
+void remove_from_walks(User *user) {
+  for (int w = 0; w < PPR_WALKS; w++) {
+    for (int i = 0; i < PPR_WALK_LEN; i++) set_walk_step(user, w, i, NULL);
+  }
+  int n;
+  WalkVisit *visits = snapshot_visits(user, NULL, &n);
+  for (int k = 0; k < n; k++) {
+    User *owner = visits[k].owner;
+    int w = visits[k].walk, i = visits[k].step;
+    if (owner->walks[w][i] != user) continue;
+    set_walk_step(owner, w, i, random_friend(owner->walks[w][i - 1]->friends));
+    extend_walk(owner, w, i);
+  }
+  free(visits);
+  free(user->visits);
+}
+
 // Users
 /**
  * Creates and returns a user. Returns NULL on failure.
  **/
 User* create_user(char* name) {
-    for (FriendNode *f = allUsers; f; f=f->next) {
-        if (strcmp(name, f->user->name)==0) return NULL;
-    }
+    if (find_user(name)) return NULL;
     User *item = (User *)calloc(1, sizeof(User));
     strcpy(item->name, name);
     item->friends = NULL;
     item->brands = NULL;
     item->visited = false;
+    init_walks(item);
     allUsers = insert_into_friend_list(allUsers, item);
+    index_insert(item);
     return item;
 }
 
@@ -275,7 +912,7 @@ User* create_user(char* name) {
  * Returns 0 on success, -1 on failure.
  **/
 int delete_user(User* user) {
-    if (!user || !in_friend_list(allUsers, user)) return -1;
+    if (!user || find_user(user->name) != user) return -1;
     FriendNode *curr = user->friends;
     FriendNode *next = NULL;
     while (curr) {
@@ -292,6 +929,8 @@ int delete_user(User* user) {
         curr_brand = next_brand;
     }
     allUsers = delete_from_friend_list(allUsers, user);
+    index_remove(user);
+    remove_from_walks(user);
     free(user);
     return 0;
 }
@@ -305,6 +944,7 @@ int add_friend(User* user, User* friend) {
     if (in_friend_list(user->friends, friend)) return -1;
     user->friends = insert_into_friend_list(user->friends, friend);
     friend->friends = insert_into_friend_list(friend->friends, user);
+    update_walks(user, friend, true);
     return 0;
 }
 
@@ -317,6 +957,7 @@ int remove_friend(User* user, User* friend) {
     if (!in_friend_list(user->friends, friend)) return -1;
     user->friends = delete_from_friend_list(user->friends, friend);
     friend->friends = delete_from_friend_list(friend->friends, user);
+    update_walks(user, friend, false);
     return 0;
 }
 
@@ -327,13 +968,11 @@ int remove_friend(User* user, User* friend) {
 int follow_brand(User* user, char* brand_name) {
     if (!user) return -1;
     if (in_brand_list(user->brands, brand_name)) return -1;
-    for (int i=0; i<MAT_SIZE; i++) {
-        if (strcmp(brand_name, brand_names[i])==0) {
-            user->brands = insert_into_brand_list(user->brands, brand_name);
-            return 0;
-        }
-    }
-    return -1;
+    int idx = get_brand_index(brand_name);
+    if (idx < 0) return -1;
+    user->brands = insert_into_brand_list(user->brands, brand_name);
+    set_brand_bit(user->brand_set, idx, true);
+    return 0;
 }
 
 /**
@@ -344,6 +983,8 @@ int unfollow_brand(User* user, char* brand_name) {
     if (!user) return -1;
     if (!in_brand_list(user->brands, brand_name)) return -1;
     user->brands = delete_from_brand_list(user->brands, brand_name);
+    int idx = get_brand_index(brand_name);
+    if (idx >= 0) set_brand_bit(user->brand_set, idx, false);
     return 0;
 }
 
@@ -352,11 +993,7 @@ int unfollow_brand(User* user, char* brand_name) {
  **/
 int get_mutual_friends(User* a, User* b) {
     if (!a || !b) return 0;
-    int n=0;
-    for (FriendNode *friend = a->friends; friend; friend=friend->next) {
-        if (in_friend_list(b->friends, friend->user)) n++;
-    }
-    return n;
+    return list_mutual_friends(a, b, NULL, 0);
 }
 
 /*
@@ -417,6 +1054,8 @@ void connect_similar_brands(char* brandNameA, char* brandNameB) {
     int B = get_brand_index(brandNameB);
     if (A != -1 && B != -1) {        brand_adjacency_matrix[A][B] = 1;
         brand_adjacency_matrix[B][A] = 1;
+        set_brand_bit(brand_similarity[A], B, true);
+        set_brand_bit(brand_similarity[B], A, true);
     }
 }
 
@@ -428,6 +1067,8 @@ void remove_similar_brands(char* brandNameA, char* brandNameB) {
     int B = get_brand_index(brandNameB);
     if (A != -1 && B != -1) {        brand_adjacency_matrix[A][B] = 0;
         brand_adjacency_matrix[B][A] = 0;
+        set_brand_bit(brand_similarity[A], B, false);
+        set_brand_bit(brand_similarity[B], A, false);
     }
 }
 
@@ -441,10 +1082,7 @@ User* get_suggested_friend(User* user) {
     User *suggested = NULL;
     for (FriendNode *friend = allUsers; friend; friend=friend->next) {
         if (friend->user != user && !in_friend_list(user->friends, friend->user)) {
-            int n=0;
-            for (BrandNode *brand = friend->user->brands; brand; brand=brand->next) {
-                if (in_brand_list(user->brands, brand->brand_name)) n++;
-            }
+            int n = count_shared_brands(user->brand_set, friend->user->brand_set);
             if (n>max) {
                 max=n;
                 suggested = friend->user;
@@ -477,52 +1115,121 @@ int add_suggested_friends(User* user, int n) {
     return count;
 }
 
+/**
+ * Returns whichever of candidate and suggested is the better graph-based
+ * suggestion: more walk hits first, then more mutual friends, then the
+ * larger name as in get_suggested_friend. Candidates marked with this
+ * call's stamp (the user and their friends) are never suggested.
+ **/
+User* better_graph_candidate(User* candidate, User* suggested, int stamp) {
+    if (candidate->friend_stamp == stamp) return suggested;
+    if (!suggested) return candidate;
+    if (candidate->walk_hits != suggested->walk_hits) {
+        return candidate->walk_hits > suggested->walk_hits ? candidate : suggested;
+    }
+    if (candidate->mutual_hits != suggested->mutual_hits) {
+        return candidate->mutual_hits > suggested->mutual_hits ? candidate : suggested;
+    }
+    return strcmp(candidate->name, suggested->name) > 0 ? candidate : suggested;
+}
+
+/**
+ * Clears the scores of a candidate the first time this call reaches it and
+ * records it in graph_candidates at position *n.
+ **/
+void reach_graph_candidate(User* candidate, int stamp, int *n) {
+    if (candidate->seen_stamp == stamp) return;
+    candidate->seen_stamp = stamp;
+    candidate->walk_hits = 0;
+    candidate->mutual_hits = 0;
+    if (*n == graph_candidates_cap) {
+        graph_candidates_cap = graph_candidates_cap ? graph_candidates_cap * 2 : 64;
+        graph_candidates = realloc(graph_candidates, graph_candidates_cap * sizeof(User*));
+    }
+    graph_candidates[(*n)++] = candidate;
+}
+
+/**
+ * Returns a suggested friend for the given user based on the friend graph
+ * instead of shared brands, returns NULL on failure. Candidates are the
+ * users reached by the user's stored random walks (a Monte-Carlo estimate of
+ * personalized PageRank) and the user's friends-of-friends. The user and
+ * their friends are stamped up front and each candidate is scored once, so
+ * the cost is the sum of the friends' degrees plus the walks, not a function
+ * of allUsers.
+ **/
+User* get_suggested_friend_graph(User* user) {
+    if (!user) return NULL;
+    int stamp = ++suggest_stamp;
+    int n = 0;
+    user->friend_stamp = stamp;
+    for (FriendNode *friend = user->friends; friend; friend=friend->next) {
+        friend->user->friend_stamp = stamp;
+    }
+    for (int w=0; w<PPR_WALKS; w++) {
+        for (int i=1; i<PPR_WALK_LEN && user->walks[w][i]; i++) {
+            reach_graph_candidate(user->walks[w][i], stamp, &n);
+            user->walks[w][i]->walk_hits++;
+        }
+    }
+    for (FriendNode *friend = user->friends; friend; friend=friend->next) {
+        for (FriendNode *f = friend->user->friends; f; f=f->next) {
+            reach_graph_candidate(f->user, stamp, &n);
+            f->user->mutual_hits++;
+        }
+    }
+    User *suggested = NULL;
+    for (int k=0; k<n; k++) {
+        suggested = better_graph_candidate(graph_candidates[k], suggested, stamp);
+    }
+    return suggested;
+}
+
+/**
+ * Friends n graph-based suggested friends for the given user.
+ * Returns how many friends were successfully followed.
+ **/
+int add_suggested_friends_graph(User* user, int n) {
+    if (!user) return 0;
+    int count=0;
+    for (int i=0; i<n; i++) {
+        User *suggested = get_suggested_friend_graph(user);
+        if (suggested) {
+            add_friend(user, suggested);
+            count++;
+        }
+    }
+    return count;
+}
+
 /**
  * Follows n suggested brands for the given user.
  * See the handout for how we define a suggested brand.     
  * Returns how many brands were successfully followed. 	  	
  **/
-int in_suggested(char suggested_array[][MAX_STR_LEN], char *brand_name, int size) {
-    for (int i=0; i<size; i++) {
-        if (strcmp(brand_name, suggested_array[i])==0) return 1;
-    }
-    return 0;
-}
 int follow_suggested_brands(User* user, int n) {
     if (!user || n<1) return 0;
-    int followed=0, curr=0, max=0;
-    char suggested[MAX_STR_LEN], suggested_array[n][MAX_STR_LEN];
-    for (int m=0; m<n; m++) {
-        strcpy(suggested, "");
-        bool changed = false;
-        max=0;
-        for (int i=0; i<MAT_SIZE; i++) {
-            curr=0;
-            if (!in_brand_list(user->brands, brand_names[i]) && !in_suggested(suggested_array, brand_names[i], followed)) {
-                for (int j=0; j<MAT_SIZE; j++) {
-                    if (in_brand_list(user->brands, brand_names[j]) && brand_adjacency_matrix[i][j]) curr++;
-                }
-                if (curr>max) {
-                    max=curr;
-                    strcpy(suggested, brand_names[i]);
-                    changed = true;
-                }
-                else if (curr==max) {
-                    if (strcmp(brand_names[i], suggested)>0) {
-                        strcpy(suggested, brand_names[i]);
-                        changed = true;
-                    }
-                }
-            }
-        }
-        if (changed) {
-            strcpy(suggested_array[followed], suggested);
-            followed++;
-            changed = false;
+    // Key each brand by score, then by name rank; 0 means it can't be suggested
+    long key[MAT_SIZE];
+    for (int i=0; i<MAT_SIZE; i++) {
+        long score = count_shared_brands(brand_similarity[i], user->brand_set);
+        long candidate = !(user->brand_set[i / 64] >> (i % 64) & 1) && brand_names[i][0] != '\0';
+        key[i] = (score * MAT_SIZE + brand_name_rank[i] + 1) * candidate;
+    }
+    int suggested[MAT_SIZE];
+    int followed=0;
+    for (; followed<n && followed<MAT_SIZE; followed++) {
+        int best=0;
+        for (int i=1; i<MAT_SIZE; i++) {
+            best = key[i] > key[best] ? i : best;
         }
+        if (key[best] == 0) break;
+        key[best] = 0;
+        suggested[followed] = best;
     }
     for (int i=0; i<followed; i++) {
-        user->brands = insert_into_brand_list(user->brands, suggested_array[i]);
+        user->brands = insert_into_brand_list(user->brands, brand_names[suggested[i]]);
+        set_brand_bit(user->brand_set, suggested[i], true);
     }
     return followed;
 }
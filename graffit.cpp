@@ -1,11 +1,171 @@
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <memory>
 #include <cstring>
 
 constexpr int MAX_STR_LEN = 1024;
+#ifndef __testing
 constexpr int MAT_SIZE = 10;
+#endif
+
+// Brand catalog with N known at compile time. Similarity rows and follow sets
+// are bitsets, so scoring a brand against a follow set is an AND and a
+// popcount. Ties go to the larger name, as in the C version; names are
+// pre-ranked so the choice is a max over integer keys with no branches; call
+// rank_names() once after setting the names.
+template <std::size_t N>
+class FixedBrandEngine {
+public:
+    using Set = std::bitset<N>;
+
+    std::size_t size() const { return N; }
+    const std::string &name(std::size_t i) const { return names[i]; }
+
+    void set_name(std::size_t i, const std::string &name) {
+        names[i] = name;
+        named.set(i, !name.empty());
+    }
+
+    void rank_names() {
+        std::array<std::size_t, N> order;
+        for (std::size_t j = 0; j < N; j++) order[j] = j;
+        std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) { return names[a] < names[b]; });
+        for (std::size_t j = 0; j < N; j++) rank[order[j]] = j;
+    }
+
+    int index(const std::string &name) const {
+        for (std::size_t i = 0; i < N; i++) {
+            if (names[i] == name) return i;
+        }
+        return -1;
+    }
+
+    bool similar(std::size_t a, std::size_t b) const { return rows[a][b]; }
+    void set_similar(std::size_t a, std::size_t b, bool value) {
+        rows[a][b] = value;
+        rows[b][a] = value;
+    }
+    void set_row_entry(std::size_t a, std::size_t b, bool value) { rows[a][b] = value; }
+
+    static int shared(const Set &a, const Set &b) { return (a & b).count(); }
+
+    // Returns the best named brand outside excluded, scored by how many of
+    // follows it is similar to, or -1 if there is none.
+    int suggest(const Set &follows, const Set &excluded) const {
+        Set candidates = named & ~excluded;
+        std::size_t best = 0;
+        int best_index = -1;
+        for (std::size_t i = 0; i < N; i++) {
+            std::size_t key = ((rows[i] & follows).count() * N + rank[i] + 1) * candidates[i];
+            best_index = key > best ? i : best_index;
+            best = key > best ? key : best;
+        }
+        return best_index;
+    }
+
+private:
+    std::array<std::string, N> names;
+    std::array<Set, N> rows;
+    std::array<std::size_t, N> rank{};
+    Set named;
+};
+
+// Word-array set sized at runtime, with the subset of the std::bitset
+// interface that DynamicBrandEngine needs.
+class DynamicBrandSet {
+public:
+    DynamicBrandSet() = default;
+    explicit DynamicBrandSet(std::size_t n) : words((n + 63) / 64, 0) {}
+
+    bool operator[](std::size_t i) const { return i / 64 < words.size() && (words[i / 64] >> (i % 64) & 1); }
+    void set(std::size_t i, bool value = true) {
+        if (i / 64 >= words.size()) words.resize(i / 64 + 1, 0);
+        uint64_t bit = uint64_t(1) << (i % 64);
+        words[i / 64] = value ? words[i / 64] | bit : words[i / 64] & ~bit;
+    }
+    void reset(std::size_t i) { set(i, false); }
+    void reset() { std::fill(words.begin(), words.end(), 0); }
+
+    static int shared(const DynamicBrandSet &a, const DynamicBrandSet &b) {
+        std::size_t n = std::min(a.words.size(), b.words.size());
+        int count = 0;
+        for (std::size_t w = 0; w < n; w++) {
+            count += __builtin_popcountll(a.words[w] & b.words[w]);
+        }
+        return count;
+    }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+// Runtime-sized fallback for catalogs too large to specialize.
+class DynamicBrandEngine {
+public:
+    using Set = DynamicBrandSet;
+
+    explicit DynamicBrandEngine(std::size_t n = MAT_SIZE) : names(n), rows(n, Set(n)), rank(n, 0), named(n) {}
+
+    std::size_t size() const { return names.size(); }
+    const std::string &name(std::size_t i) const { return names[i]; }
+
+    void set_name(std::size_t i, const std::string &name) {
+        names[i] = name;
+        named.set(i, !name.empty());
+    }
+
+    void rank_names() {
+        std::vector<std::size_t> order(size());
+        for (std::size_t j = 0; j < size(); j++) order[j] = j;
+        std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) { return names[a] < names[b]; });
+        for (std::size_t j = 0; j < size(); j++) rank[order[j]] = j;
+    }
+
+    int index(const std::string &name) const {
+        for (std::size_t i = 0; i < size(); i++) {
+            if (names[i] == name) return i;
+        }
+        return -1;
+    }
+
+    bool similar(std::size_t a, std::size_t b) const { return rows[a][b]; }
+    void set_similar(std::size_t a, std::size_t b, bool value) {
+        rows[a].set(b, value);
+        rows[b].set(a, value);
+    }
+    void set_row_entry(std::size_t a, std::size_t b, bool value) { rows[a].set(b, value); }
+
+    static int shared(const Set &a, const Set &b) { return Set::shared(a, b); }
+
+    int suggest(const Set &follows, const Set &excluded) const {
+        std::size_t n = size(), best = 0;
+        int best_index = -1;
+        for (std::size_t i = 0; i < n; i++) {
+            std::size_t key = (Set::shared(rows[i], follows) * n + rank[i] + 1) * (named[i] && !excluded[i]);
+            best_index = key > best ? i : best_index;
+            best = key > best ? key : best;
+        }
+        return best_index;
+    }
+
+private:
+    std::vector<std::string> names;
+    std::vector<Set> rows;
+    std::vector<std::size_t> rank;
+    Set named;
+};
+
+template <std::size_t N>
+using BrandEngineFor = typename std::conditional<(N <= 256), FixedBrandEngine<N>, DynamicBrandEngine>::type;
+using BrandEngine = BrandEngineFor<MAT_SIZE>;
+using BrandSet = BrandEngine::Set;
 
 struct BrandNode;
 struct FriendNode;
@@ -14,6 +174,7 @@ struct User {
     std::string name;
     std::shared_ptr<FriendNode> friends;
     std::shared_ptr<BrandNode> brands;
+    BrandSet brand_set;
     bool visited = false;
     int level = 0;
 };
@@ -29,8 +190,7 @@ struct BrandNode {
 };
 
 std::shared_ptr<FriendNode> allUsers = nullptr;
-int brand_adjacency_matrix[MAT_SIZE][MAT_SIZE] = {0};
-std::string brand_names[MAT_SIZE];
+BrandEngine brand_engine;
 
 bool in_friend_list(std::shared_ptr<FriendNode> head, std::shared_ptr<User> node) {
     for (auto cur = head; cur != nullptr; cur = cur->next) {
@@ -130,37 +290,157 @@ std::shared_ptr<BrandNode> delete_from_brand_list(std::shared_ptr<BrandNode> hea
     return head;
 }
 
-void print_user_data(const std::shared_ptr<User> &user) {
-    std::cout << "User name: " << user->name << "\nFriends:\n";
-    for (auto f = user->friends; f != nullptr; f = f->next) {
-        std::cout << "   " << f->user->name << "\n";
+int get_brand_index(const std::string &name) {
+    return brand_engine.index(name);
+}
+
+// The list_* functions write up to cap results into out (which may be null
+// when cap is 0) without printing or allocating, and walk the lists through
+// raw pointers so no reference counts change. They return the total number
+// of results, which is more than cap if out was too small, or -1 on failure.
+
+int list_friends(const std::shared_ptr<User> &user, User **out, int cap) {
+    if (!user) return -1;
+    int n = 0;
+    for (FriendNode *f = user->friends.get(); f; f = f->next.get(), n++) {
+        if (n < cap) out[n] = f->user.get();
     }
-    std::cout << "Brands:\n";
-    for (auto b = user->brands; b != nullptr; b = b->next) {
-        std::cout << "   " << b->brand_name << "\n";
+    return n;
+}
+
+int list_brands(const std::shared_ptr<User> &user, const std::string **out, int cap) {
+    if (!user) return -1;
+    int n = 0;
+    for (BrandNode *b = user->brands.get(); b; b = b->next.get(), n++) {
+        if (n < cap) out[n] = &b->brand_name;
     }
+    return n;
 }
 
-int get_brand_index(const std::string &name) {
-    for (int i = 0; i < MAT_SIZE; i++) {
-        if (brand_names[i] == name) {
-            return i;
+int list_similar_brands(const std::string &brand_name, const std::string **out, int cap) {
+    int idx = get_brand_index(brand_name);
+    if (idx < 0) return -1;
+    int n = 0;
+    for (std::size_t i = 0; i < brand_engine.size(); i++) {
+        if (brand_engine.similar(idx, i) && !brand_engine.name(i).empty()) {
+            if (n < cap) out[n] = &brand_engine.name(i);
+            n++;
         }
     }
-    std::cout << "brand '" << name << "' not found\n";
-    return -1;
+    return n;
 }
 
-void print_brand_data(const std::string &brand_name) {
+int list_mutual_friends(const std::shared_ptr<User> &a, const std::shared_ptr<User> &b, User **out, int cap) {
+    if (!a || !b) return -1;
+    int n = 0;
+    FriendNode *x = a->friends.get(), *y = b->friends.get();
+    while (x && y) {
+        int cmp = x->user->name.compare(y->user->name);
+        if (cmp == 0) {
+            if (n < cap) out[n] = x->user.get();
+            n++;
+        }
+        if (cmp <= 0) x = x->next.get();
+        if (cmp >= 0) y = y->next.get();
+    }
+    return n;
+}
+
+// Collects dump output in a fixed buffer and hands it to the stream in large
+// writes instead of one stream insertion per line. Flushes on destruction.
+class DumpBuffer {
+public:
+    explicit DumpBuffer(std::ostream &out) : out(out) {}
+    ~DumpBuffer() { flush(); }
+
+    DumpBuffer &operator<<(const std::string &s) { return append(s.data(), s.size()); }
+    DumpBuffer &operator<<(const char *s) { return append(s, std::strlen(s)); }
+    DumpBuffer &operator<<(int value) { return *this << std::to_string(value); }
+
+    void flush() {
+        out.write(buf, len);
+        len = 0;
+    }
+
+private:
+    DumpBuffer &append(const char *s, std::size_t n) {
+        while (n > 0) {
+            if (len == sizeof(buf)) flush();
+            std::size_t chunk = std::min(n, sizeof(buf) - len);
+            std::memcpy(buf + len, s, chunk);
+            len += chunk;
+            s += chunk;
+            n -= chunk;
+        }
+        return *this;
+    }
+
+    std::ostream &out;
+    char buf[8192];
+    std::size_t len = 0;
+};
+
+void dump_user_data(DumpBuffer &d, const std::shared_ptr<User> &user) {
+    d << "User name: " << user->name << "\nFriends:\n";
+    for (FriendNode *f = user->friends.get(); f; f = f->next.get()) {
+        d << "   " << f->user->name << "\n";
+    }
+    d << "Brands:\n";
+    for (BrandNode *b = user->brands.get(); b; b = b->next.get()) {
+        d << "   " << b->brand_name << "\n";
+    }
+}
+
+void dump_brand_data(DumpBuffer &d, const std::string &brand_name) {
     int idx = get_brand_index(brand_name);
     if (idx < 0) {
-        std::cout << "Brand '" << brand_name << "' not in the list.\n";
+        d << "Brand '" << brand_name << "' not in the list.\n";
         return;
     }
-    std::cout << "Brand name: " << brand_name << "\nBrand idx: " << idx << "\nSimilar brands:\n";
-    for (int i = 0; i < MAT_SIZE; i++) {
-        if (brand_adjacency_matrix[idx][i] == 1 && !brand_names[i].empty()) {
-            std::cout << "   " << brand_names[i] << "\n";
+    d << "Brand name: " << brand_name << "\nBrand idx: " << idx << "\nSimilar brands:\n";
+    for (std::size_t i = 0; i < brand_engine.size(); i++) {
+        if (brand_engine.similar(idx, i) && !brand_engine.name(i).empty()) {
+            d << "   " << brand_engine.name(i) << "\n";
+        }
+    }
+}
+
+void dump_all_users(std::ostream &out) {
+    DumpBuffer d(out);
+    for (FriendNode *f = allUsers.get(); f; f = f->next.get()) {
+        dump_user_data(d, f->user);
+    }
+}
+
+void print_user_data(const std::shared_ptr<User> &user) {
+    DumpBuffer d(std::cout);
+    dump_user_data(d, user);
+}
+
+void print_brand_data(const std::string &brand_name) {
+    DumpBuffer d(std::cout);
+    dump_brand_data(d, brand_name);
+}
+
+void populate_brand_matrix(const std::string &file_name) {
+    std::ifstream f(file_name);
+    std::string line;
+    f >> line;
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < brand_engine.size(); i++) {
+        std::size_t comma = line.find(',', start);
+        if (i == brand_engine.size() - 1 || comma == std::string::npos) {
+            brand_engine.set_name(i, line.substr(start));
+            break;
+        }
+        brand_engine.set_name(i, line.substr(start, comma - start));
+        start = comma + 1;
+    }
+    brand_engine.rank_names();
+    for (std::size_t x = 0; x < brand_engine.size(); x++) {
+        f >> line;
+        for (std::size_t y = 0; y < brand_engine.size(); y++) {
+            brand_engine.set_row_entry(x, y, y * 2 < line.size() && line[y * 2] != '0');
         }
     }
 }
@@ -183,6 +463,7 @@ int delete_user(const std::shared_ptr<User> &user) {
     }
     user->friends = nullptr;
     user->brands = nullptr;
+    user->brand_set.reset();
     allUsers = delete_from_friend_list(allUsers, user);
     return 0;
 }
@@ -208,14 +489,12 @@ int remove_friend(const std::shared_ptr<User> &user, const std::shared_ptr<User>
 int follow_brand(const std::shared_ptr<User> &user, const std::string &brand_name) {
     if (!user) return -1;
     if (in_brand_list(user->brands, brand_name)) return -1;
-    
-    for (const auto &brand : brand_names) {
-        if (brand == brand_name) {
-            user->brands = insert_into_brand_list(user->brands, brand_name);
-            return 0;
-        }
-    }
-    return -1;
+
+    int idx = brand_engine.index(brand_name);
+    if (idx < 0) return -1;
+    user->brands = insert_into_brand_list(user->brands, brand_name);
+    user->brand_set.set(idx);
+    return 0;
 }
 
 int unfollow_brand(const std::shared_ptr<User> &user, const std::string &brand_name) {
@@ -223,6 +502,8 @@ int unfollow_brand(const std::shared_ptr<User> &user, const std::string &brand_n
     if (!in_brand_list(user->brands, brand_name)) return -1;
 
     user->brands = delete_from_brand_list(user->brands, brand_name);
+    int idx = brand_engine.index(brand_name);
+    if (idx >= 0) user->brand_set.reset(idx);
     return 0;
 }
 
@@ -230,8 +511,7 @@ void connect_similar_brands(const std::string &brandNameA, const std::string &br
     int A = get_brand_index(brandNameA);
     int B = get_brand_index(brandNameB);
     if (A != -1 && B != -1) {
-        brand_adjacency_matrix[A][B] = 1;
-        brand_adjacency_matrix[B][A] = 1;
+        brand_engine.set_similar(A, B, true);
     }
 }
 
@@ -239,8 +519,50 @@ void remove_similar_brands(const std::string &brandNameA, const std::string &bra
     int A = get_brand_index(brandNameA);
     int B = get_brand_index(brandNameB);
     if (A != -1 && B != -1) {
-        brand_adjacency_matrix[A][B] = 0;
-        brand_adjacency_matrix[B][A] = 0;
+        brand_engine.set_similar(A, B, false);
+    }
+}
+
+std::shared_ptr<User> get_suggested_friend(const std::shared_ptr<User> &user) {
+    if (!user) return nullptr;
+    int max = 0;
+    std::shared_ptr<User> suggested = nullptr;
+    for (auto f = allUsers; f; f = f->next) {
+        if (f->user == user || in_friend_list(user->friends, f->user)) continue;
+        int n = BrandEngine::shared(user->brand_set, f->user->brand_set);
+        if (n > max || (n == max && (!suggested || f->user->name > suggested->name))) {
+            max = n;
+            suggested = f->user;
+        }
+    }
+    return suggested;
+}
+
+int add_suggested_friends(const std::shared_ptr<User> &user, int n) {
+    if (!user) return 0;
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        auto suggested = get_suggested_friend(user);
+        if (suggested) {
+            add_friend(user, suggested);
+            count++;
+        }
     }
+    return count;
 }
 
+int follow_suggested_brands(const std::shared_ptr<User> &user, int n) {
+    if (!user || n < 1) return 0;
+    BrandSet excluded = user->brand_set;
+    std::vector<int> suggested;
+    for (int m = 0; m < n; m++) {
+        int idx = brand_engine.suggest(user->brand_set, excluded);
+        if (idx < 0) break;
+        excluded.set(idx);
+        suggested.push_back(idx);
+    }
+    for (int idx : suggested) {
+        follow_brand(user, brand_engine.name(idx));
+    }
+    return suggested.size();
+}
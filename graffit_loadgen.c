@@ -0,0 +1,211 @@
+/**
+ * Load generator for graffit_server. Creates a population of users and
+ * random friendships, then sends a mix of queries and updates over a single
+ * connection with up to `depth` requests in flight, and reports throughput
+ * and latency percentiles.
+ *
+ * Usage: graffit_loadgen <socket_path> [requests] [depth] [users] [brand]
+ *
+ * Follow/unfollow requests are only part of the mix when a brand from the
+ * server's catalog is given.
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "graffit_protocol.h"
+
+#define SETUP_BATCH 1024
+
+typedef struct {
+    int fd;
+    char *out;
+    size_t out_len, out_cap, out_sent;
+    char in[1 << 16];
+    size_t in_len;
+} Client;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void append(Client *c, const void *data, size_t len) {
+    if (c->out_len + len > c->out_cap) {
+        c->out_cap = (c->out_len + len) * 2;
+        c->out = realloc(c->out, c->out_cap);
+    }
+    memcpy(c->out + c->out_len, data, len);
+    c->out_len += len;
+}
+
+/**
+ * Queues a request with one or two string arguments (b may be NULL).
+ **/
+static void queue_request(Client *c, GraffitOp op, const char *a, const char *b) {
+    uint16_t a_len = strlen(a), b_len = b ? strlen(b) : 0;
+    FrameHeader h = {0};
+    h.len = sizeof(a_len) + a_len + (b ? sizeof(b_len) + b_len : 0);
+    h.op = op;
+    append(c, &h, sizeof(h));
+    append(c, &a_len, sizeof(a_len));
+    append(c, a, a_len);
+    if (b) {
+        append(c, &b_len, sizeof(b_len));
+        append(c, b, b_len);
+    }
+}
+
+/**
+ * Waits until the socket is readable, or writable while requests are queued,
+ * then writes as much as the server takes and consumes every complete
+ * response. Returns how many responses were consumed. Reading while writing
+ * keeps a deep pipeline from deadlocking once the server stops reading
+ * because its output to us is backed up.
+ **/
+static int pump(Client *c) {
+    struct pollfd p = {0};
+    p.fd = c->fd;
+    p.events = POLLIN | (c->out_sent < c->out_len ? POLLOUT : 0);
+    while (poll(&p, 1, -1) < 0) {
+        if (errno != EINTR) {
+            perror("poll");
+            exit(1);
+        }
+    }
+    if (p.revents & POLLOUT) {
+        ssize_t n = write(c->fd, c->out + c->out_sent, c->out_len - c->out_sent);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            perror("write");
+            exit(1);
+        }
+        if (n > 0) c->out_sent += n;
+        if (c->out_sent == c->out_len) c->out_len = c->out_sent = 0;
+    }
+
+    int count = 0;
+    if (p.revents & (POLLIN | POLLHUP | POLLERR)) {
+        ssize_t n = read(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+        if (n <= 0) {
+            fprintf(stderr, "server closed the connection\n");
+            exit(1);
+        }
+        c->in_len += n;
+        size_t off = 0;
+        FrameHeader h;
+        while (c->in_len - off >= sizeof(h)) {
+            memcpy(&h, c->in + off, sizeof(h));
+            if (c->in_len - off < sizeof(h) + h.len) break;
+            off += sizeof(h) + h.len;
+            count++;
+        }
+        memmove(c->in, c->in + off, c->in_len - off);
+        c->in_len -= off;
+    }
+    return count;
+}
+
+static int compare_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Queues one request picked from the benchmark mix.
+ **/
+static void queue_random_request(Client *c, int users, const char *brand) {
+    char a[32], b[32];
+    snprintf(a, sizeof(a), "user%d", rand() % users);
+    snprintf(b, sizeof(b), "user%d", rand() % users);
+    int r = rand() % (brand ? 100 : 90);
+    if (r < 20) queue_request(c, OP_ADD_FRIEND, a, b);
+    else if (r < 30) queue_request(c, OP_REMOVE_FRIEND, a, b);
+    else if (r < 60) queue_request(c, OP_MUTUAL_FRIENDS, a, b);
+    else if (r < 65) queue_request(c, OP_DEGREES, a, b);
+    else if (r < 80) queue_request(c, OP_SUGGEST_FRIEND_GRAPH, a, NULL);
+    else if (r < 90) queue_request(c, OP_SUGGEST_FRIEND, a, NULL);
+    else queue_request(c, r < 95 ? OP_FOLLOW_BRAND : OP_UNFOLLOW_BRAND, a, brand);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <socket_path> [requests] [depth] [users] [brand]\n", argv[0]);
+        return 1;
+    }
+    int requests = argc > 2 ? atoi(argv[2]) : 100000;
+    int depth = argc > 3 ? atoi(argv[3]) : 32;
+    int users = argc > 4 ? atoi(argv[4]) : 1000;
+    const char *brand = argc > 5 ? argv[5] : NULL;
+    if (requests < 1 || depth < 1 || users < 2) {
+        fprintf(stderr, "requests, depth and users must be positive (users >= 2)\n");
+        return 1;
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", argv[1]);
+    Client c = {0};
+    c.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (c.fd < 0 || connect(c.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        return 1;
+    }
+    fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL) | O_NONBLOCK);
+    srand(42);
+
+    // Populate the graph in bounded batches; these requests are not timed
+    char a[32], b[32];
+    int pending = 0;
+    for (int i = 0; i < users * 5; i++) {
+        if (i < users) {
+            snprintf(a, sizeof(a), "user%d", i);
+            queue_request(&c, OP_CREATE_USER, a, NULL);
+        } else {
+            snprintf(a, sizeof(a), "user%d", rand() % users);
+            snprintf(b, sizeof(b), "user%d", rand() % users);
+            queue_request(&c, OP_ADD_FRIEND, a, b);
+        }
+        if (++pending == SETUP_BATCH || i == users * 5 - 1) {
+            while (pending > 0) pending -= pump(&c);
+        }
+    }
+
+    long long *sent_at = malloc(requests * sizeof(long long));
+    long long *latency = malloc(requests * sizeof(long long));
+    int sent = 0, done = 0;
+    long long start = now_ns();
+    while (done < requests) {
+        while (sent < requests && sent - done < depth) {
+            queue_random_request(&c, users, brand);
+            sent_at[sent++] = now_ns();
+        }
+        int n = pump(&c);
+        long long t = now_ns();
+        for (int i = 0; i < n; i++, done++) latency[done] = t - sent_at[done];
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    qsort(latency, requests, sizeof(long long), compare_ll);
+    printf("requests: %d  depth: %d  users: %d\n", requests, depth, users);
+    printf("throughput: %.0f req/s\n", requests / elapsed);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           latency[requests / 2] / 1e3, latency[requests * 9 / 10] / 1e3,
+           latency[requests * 99 / 100] / 1e3, latency[requests * 999 / 1000] / 1e3,
+           latency[requests - 1] / 1e3);
+    free(sent_at);
+    free(latency);
+    free(c.out);
+    close(c.fd);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef GRAFFIT_PROTOCOL_H
+#define GRAFFIT_PROTOCOL_H
+
+#include <stdint.h>
+
+/**
+ * Wire protocol between graffit_server and its clients over a Unix-domain
+ * socket. Both ends live on the same host, so integers are sent in native
+ * byte order.
+ *
+ * Every frame is a FrameHeader followed by `len` bytes of payload.
+ *   Request payload:  one or two strings, each a uint16_t length followed by
+ *                     that many bytes (no terminator).
+ *   Response payload: an int32_t value, followed by a name (no length
+ *                     prefix, no terminator) for suggestion requests.
+ * Clients may pipeline any number of requests; responses come back in the
+ * same order.
+ **/
+
+#define PROTOCOL_MAX_PAYLOAD 4096
+
+typedef enum {
+    OP_CREATE_USER = 1,       // name                 -> 0
+    OP_DELETE_USER,           // name                 -> 0
+    OP_ADD_FRIEND,            // name, name           -> 0
+    OP_REMOVE_FRIEND,         // name, name           -> 0
+    OP_MUTUAL_FRIENDS,        // name, name           -> count
+    OP_DEGREES,               // name, name           -> degrees or -1
+    OP_SUGGEST_FRIEND,        // name                 -> 0, suggested name
+    OP_SUGGEST_FRIEND_GRAPH,  // name                 -> 0, suggested name
+    OP_FOLLOW_BRAND,          // name, brand          -> 0
+    OP_UNFOLLOW_BRAND,        // name, brand          -> 0
+} GraffitOp;
+
+typedef enum {
+    STATUS_OK = 0,
+    STATUS_FAILED,       // the operation returned failure or a user is unknown
+    STATUS_BAD_REQUEST,  // unknown op or malformed payload
+} GraffitStatus;
+
+typedef struct {
+    uint32_t len;
+    uint8_t op;      // GraffitOp in requests, GraffitStatus in responses
+    uint8_t pad[3];
+} FrameHeader;
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * Serves one shared graph over a Unix-domain socket using the protocol in
+ * graffit_protocol.h.
+ *
+ * Usage: graffit_server <socket_path> [brands_file]
+ *
+ * A single-threaded epoll loop owns the graph. Each event on a connection
+ * reads a batch of input, handles the complete requests in it in order, and
+ * sends the responses back in one write. The work per event is bounded, so a
+ * fast client cannot starve the others: requests wait in the input buffer
+ * while too much output is pending, and reading stops while too much input
+ * is.
+ **/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "graffit.c"
+#include "graffit_protocol.h"
+
+#define MAX_EVENTS 64
+#define READ_CHUNK 65536
+#define READ_BUDGET (4 * READ_CHUNK)
+#define MAX_PENDING_INPUT (1 << 20)
+#define MAX_PENDING_OUTPUT (1 << 20)
+#define MAX_REQUESTS_PER_EVENT 1024
+
+typedef struct {
+    int fd;
+    char *in;
+    size_t in_len, in_cap;
+    char *out;
+    size_t out_len, out_cap, out_sent;
+    uint32_t events;
+    bool read_closed;
+} Connection;
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+/**
+ * Makes sure buf can hold at least need bytes, doubling its capacity.
+ **/
+static void reserve(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return;
+    size_t new_cap = *cap ? *cap : 4096;
+    while (new_cap < need) new_cap *= 2;
+    *buf = realloc(*buf, new_cap);
+    *cap = new_cap;
+}
+
+/**
+ * Reads the next length-prefixed string of a request payload into dst.
+ * Returns 0 on success, -1 if the payload is malformed.
+ **/
+static int read_string(const char **p, const char *end, char dst[MAX_STR_LEN]) {
+    uint16_t len;
+    if (end - *p < (long)sizeof(len)) return -1;
+    memcpy(&len, *p, sizeof(len));
+    *p += sizeof(len);
+    if (len >= MAX_STR_LEN || end - *p < len) return -1;
+    memcpy(dst, *p, len);
+    dst[len] = '\0';
+    *p += len;
+    return 0;
+}
+
+/**
+ * Appends one response frame to the connection's output buffer.
+ **/
+static void respond(Connection *c, GraffitStatus status, int32_t value, const char *name) {
+    size_t name_len = name ? strlen(name) : 0;
+    FrameHeader h = {0};
+    h.len = sizeof(value) + name_len;
+    h.op = status;
+    reserve(&c->out, &c->out_cap, c->out_len + sizeof(h) + h.len);
+    memcpy(c->out + c->out_len, &h, sizeof(h));
+    memcpy(c->out + c->out_len + sizeof(h), &value, sizeof(value));
+    if (name_len) memcpy(c->out + c->out_len + sizeof(h) + sizeof(value), name, name_len);
+    c->out_len += sizeof(h) + h.len;
+}
+
+/**
+ * Runs one request against the graph and queues its response.
+ **/
+static void handle_request(Connection *c, uint8_t op, const char *p, const char *end) {
+    static char a[MAX_STR_LEN], b[MAX_STR_LEN];
+    int args = (op == OP_CREATE_USER || op == OP_DELETE_USER ||
+                op == OP_SUGGEST_FRIEND || op == OP_SUGGEST_FRIEND_GRAPH) ? 1 : 2;
+    if (op < OP_CREATE_USER || op > OP_UNFOLLOW_BRAND ||
+        read_string(&p, end, a) != 0 || (args == 2 && read_string(&p, end, b) != 0) || p != end) {
+        respond(c, STATUS_BAD_REQUEST, -1, NULL);
+        return;
+    }
+
+    if (op == OP_CREATE_USER) {
+        respond(c, create_user(a) ? STATUS_OK : STATUS_FAILED, 0, NULL);
+        return;
+    }
+    User *user = find_user(a);
+    if (!user) {
+        respond(c, STATUS_FAILED, -1, NULL);
+        return;
+    }
+    if (op == OP_FOLLOW_BRAND || op == OP_UNFOLLOW_BRAND) {
+        int rc = op == OP_FOLLOW_BRAND ? follow_brand(user, b) : unfollow_brand(user, b);
+        respond(c, rc == 0 ? STATUS_OK : STATUS_FAILED, rc, NULL);
+        return;
+    }
+    if (op == OP_DELETE_USER || op == OP_SUGGEST_FRIEND || op == OP_SUGGEST_FRIEND_GRAPH) {
+        if (op == OP_DELETE_USER) {
+            respond(c, delete_user(user) == 0 ? STATUS_OK : STATUS_FAILED, 0, NULL);
+            return;
+        }
+        User *suggested = op == OP_SUGGEST_FRIEND ? get_suggested_friend(user)
+                                                  : get_suggested_friend_graph(user);
+        respond(c, suggested ? STATUS_OK : STATUS_FAILED, 0, suggested ? suggested->name : NULL);
+        return;
+    }
+
+    User *other = find_user(b);
+    if (!other) {
+        respond(c, STATUS_FAILED, -1, NULL);
+        return;
+    }
+    int rc;
+    switch (op) {
+        case OP_ADD_FRIEND:
+            rc = add_friend(user, other);
+            respond(c, rc == 0 ? STATUS_OK : STATUS_FAILED, rc, NULL);
+            break;
+        case OP_REMOVE_FRIEND:
+            rc = remove_friend(user, other);
+            respond(c, rc == 0 ? STATUS_OK : STATUS_FAILED, rc, NULL);
+            break;
+        case OP_MUTUAL_FRIENDS:
+            respond(c, STATUS_OK, get_mutual_friends(user, other), NULL);
+            break;
+        case OP_DEGREES:
+            respond(c, STATUS_OK, get_degrees_of_connection(user, other), NULL);
+            break;
+    }
+}
+
+/**
+ * Returns whether the input buffer starts with a complete request.
+ **/
+static bool has_request(Connection *c) {
+    FrameHeader h;
+    if (c->in_len < sizeof(h)) return false;
+    memcpy(&h, c->in, sizeof(h));
+    return h.len > PROTOCOL_MAX_PAYLOAD || c->in_len >= sizeof(h) + h.len;
+}
+
+/**
+ * Handles complete requests from the input buffer until it runs out, the
+ * per-event budget is spent or too much output is pending. The rest stays
+ * buffered for the next event. Returns -1 if the client sent an oversized
+ * frame.
+ **/
+static int handle_input(Connection *c) {
+    if (c->out_sent > 0) {
+        memmove(c->out, c->out + c->out_sent, c->out_len - c->out_sent);
+        c->out_len -= c->out_sent;
+        c->out_sent = 0;
+    }
+    size_t off = 0;
+    for (int handled = 0; handled < MAX_REQUESTS_PER_EVENT && c->out_len < MAX_PENDING_OUTPUT &&
+                          c->in_len - off >= sizeof(FrameHeader); handled++) {
+        FrameHeader h;
+        memcpy(&h, c->in + off, sizeof(h));
+        if (h.len > PROTOCOL_MAX_PAYLOAD) return -1;
+        if (c->in_len - off < sizeof(h) + h.len) break;
+        const char *payload = c->in + off + sizeof(h);
+        handle_request(c, h.op, payload, payload + h.len);
+        off += sizeof(h) + h.len;
+    }
+    memmove(c->in, c->in + off, c->in_len - off);
+    c->in_len -= off;
+    return 0;
+}
+
+/**
+ * Writes as much pending output as the socket takes. Returns -1 if the
+ * connection failed.
+ **/
+static int flush_output(Connection *c) {
+    while (c->out_sent < c->out_len) {
+        ssize_t n = write(c->fd, c->out + c->out_sent, c->out_len - c->out_sent);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->out_sent += n;
+    }
+    c->out_len = c->out_sent = 0;
+    return 0;
+}
+
+/**
+ * Reads up to READ_BUDGET bytes from the connection, stopping early once
+ * MAX_PENDING_INPUT bytes are buffered. Returns 1 if the client closed its
+ * end, 0 otherwise, -1 on error.
+ **/
+static int fill_input(Connection *c) {
+    size_t budget = READ_BUDGET;
+    while (budget > 0 && c->in_len < MAX_PENDING_INPUT) {
+        reserve(&c->in, &c->in_cap, c->in_len + READ_CHUNK);
+        size_t want = c->in_cap - c->in_len < budget ? c->in_cap - c->in_len : budget;
+        ssize_t n = read(c->fd, c->in + c->in_len, want);
+        if (n > 0) {
+            c->in_len += n;
+            budget -= n;
+            continue;
+        }
+        if (n == 0) return 1;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        if (errno == EINTR) continue;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Re-registers the connection for the events it currently cares about:
+ * input while the client may send more and neither buffer is full, output
+ * while responses are pending. Output interest is also kept while buffered
+ * requests wait to be handled, since a writable socket is what resumes them.
+ **/
+static void update_interest(int epfd, Connection *c) {
+    size_t pending = c->out_len - c->out_sent;
+    bool reading = !c->read_closed && pending < MAX_PENDING_OUTPUT && c->in_len < MAX_PENDING_INPUT;
+    uint32_t events = (reading ? EPOLLIN : 0) | (pending || has_request(c) ? EPOLLOUT : 0);
+    if (events == c->events) return;
+    struct epoll_event ev = {0};
+    ev.events = c->events = events;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void close_connection(int epfd, Connection *c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+static void accept_connections(int epfd, int listen_fd) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        Connection *c = calloc(1, sizeof(Connection));
+        c->fd = fd;
+        c->events = EPOLLIN;
+        struct epoll_event ev = {0};
+        ev.events = c->events;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <socket_path> [brands_file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 3) {
+        if (access(argv[2], R_OK) != 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        populate_brand_matrix(argv[2]);
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(argv[1]) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, argv[1]);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(addr.sun_path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (running) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            Connection *c = events[i].data.ptr;
+            if (!c) {
+                accept_connections(epfd, listen_fd);
+                continue;
+            }
+            bool failed = false;
+            if (!c->read_closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                int rc = fill_input(c);
+                failed = rc < 0;
+                c->read_closed = rc == 1;
+            }
+            failed = failed || handle_input(c) != 0 || flush_output(c) != 0;
+            // A half-closed client still gets every response it asked for
+            bool finished = c->read_closed && c->out_sent == c->out_len && !has_request(c);
+            if (failed || finished) {
+                close_connection(epfd, c);
+                continue;
+            }
+            update_interest(epfd, c);
+        }
+    }
+
+    close(listen_fd);
+    unlink(addr.sun_path);
+    return 0;
+}